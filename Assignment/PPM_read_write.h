@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 
 #define FAILURE 0
@@ -28,6 +29,8 @@ static const char _delim[] = " \t\n";
 typedef struct PPM
 {
 	unsigned int tag, width, height, maxColor, pixels_count, size;
+	// offset in the input file where the pixel data starts
+	long pixels_offset;
 	unsigned char *pixels;
 	unsigned char *outputPixels;
 } PPM;
@@ -61,13 +64,14 @@ unsigned int readPixels(PPM *ppm, FILE *f)
 }
 
 /**
-* This method is used to read and store PPM information
+* This method is used to parse the PPM header and optionally read the pixels
 * for both P3 and P6 formats.
 * @param *fname Pointer to input file name
 * @param *ppm Pointer to PPM structure
+* @param read_pixels Whether the pixels should be allocated and read as well
 * @return int 1 if success and 0 if failure
 */
-_Bool readPPM(const char *fname, PPM *ppm)
+_Bool parsePPM(const char *fname, PPM *ppm, _Bool read_pixels)
 {
 	// Set the reading mode to look for tag first as it should
 	// be the first element present in the input file
@@ -129,8 +133,22 @@ _Bool readPPM(const char *fname, PPM *ppm)
 					if (!reading_params) break;
 					// read the pixels
 				case PIXELS:
+					ppm->pixels_offset = ftell(f);
+					// images of 4 GiB or more can not be held in memory, only their header can be read
+					if ((unsigned long long)ppm->width * ppm->height * RGB_SIZE > UINT_MAX) {
+						ppm->pixels_count = ppm->size = 0;
+						ppm->pixels = NULL;
+						fclose(f);
+						if (read_pixels) fprintf(stderr, "Error: Image is too large to be read at once, please use the shard mode \n");
+						return !read_pixels;
+					}
 					ppm->pixels_count = ppm->width * ppm->height;
 					ppm->size = ppm->width * ppm->height * RGB_SIZE;
+					if (!read_pixels) {
+						ppm->pixels = NULL;
+						fclose(f);
+						return SUCCESS;
+					}
 					ppm->pixels = malloc(sizeof(char)*ppm->size);
 					memset(ppm->pixels, 0, ppm->size);
 					unsigned int processed_pixels = readPixels(ppm, f);
@@ -149,6 +167,30 @@ _Bool readPPM(const char *fname, PPM *ppm)
 	return SUCCESS;
 }
 
+/**
+* This method is used to read and store PPM information
+* for both P3 and P6 formats.
+* @param *fname Pointer to input file name
+* @param *ppm Pointer to PPM structure
+* @return int 1 if success and 0 if failure
+*/
+_Bool readPPM(const char *fname, PPM *ppm)
+{
+	return parsePPM(fname, ppm, 1);
+}
+
+/**
+* This method is used to read only the PPM header and the offset of the pixel data
+* for both P3 and P6 formats. The pixels_count and size are 0 for images of 4 GiB or more.
+* @param *fname Pointer to input file name
+* @param *ppm Pointer to PPM structure
+* @return int 1 if success and 0 if failure
+*/
+_Bool readPPMHeader(const char *fname, PPM *ppm)
+{
+	return parsePPM(fname, ppm, 0);
+}
+
 /**
 * This method is used to write pixels to file
 * either in P3 - plain text or P6 - binary formats.
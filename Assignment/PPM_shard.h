@@ -0,0 +1,286 @@
+// Sharded execution where each process mosaics a disjoint range of block rows
+typedef enum SHARD_MODE { SHARD_NONE, SHARD_CREATE, SHARD_WORKER, SHARD_LAUNCH, SHARD_MERGE } SHARD_MODE;
+
+// pread/pwrite and fork are only available on POSIX systems
+#ifndef _WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Max number of characters of a P6 output header
+#define MAX_HEADER	64
+
+/**
+* This method is used to build the P6 header exactly as writeToFile writes it
+* so that shards can compute where the output pixel data starts.
+* @param *ppm  Pointer to PPM structure
+* @param *header  Buffer of MAX_HEADER characters receiving the header
+* @return int This returns the length of the header.
+*/
+int buildBinaryHeader(PPM *ppm, char *header)
+{
+	return snprintf(header, MAX_HEADER, "P%d\n%d\n%d\n%d\n", PPM_BINARY, ppm->width, ppm->height, ppm->maxColor);
+}
+
+/**
+* This method is used to compute the size of the pixel data of an image
+* which can be larger than the 32 bit size of the PPM structure
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @return off_t The number of bytes of the pixel data
+*/
+off_t shardedPixelsSize(PPM *ppm)
+{
+	return (off_t)ppm->width * ppm->height * RGB_SIZE;
+}
+
+/**
+* This method is used to read the pixels of a range of image rows
+* from a P6 file without reading the rest of the image.
+* @param *fname  Pointer to input file name
+* @param *ppm  Pointer to PPM structure holding the header of the input
+* @param first_row  The first image row to read
+* @param rows  The number of image rows to read
+* @param *pixels  Pointer to the buffer receiving rows * width pixels
+* @return int This returns 1 if all the pixels were read or 0 otherwise.
+*/
+_Bool readPPMRows(const char *fname, PPM *ppm, unsigned int first_row, unsigned int rows, unsigned char *pixels)
+{
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Can't open %s file for reading\n", fname);
+		return FAILURE;
+	}
+
+	size_t row_size = (size_t)ppm->width * RGB_SIZE;
+	size_t remaining = row_size * rows;
+	off_t offset = ppm->pixels_offset + (off_t)first_row * row_size;
+	// pread may return less than requested so keep reading until the range is complete
+	while (remaining > 0) {
+		ssize_t processed = pread(fd, pixels, remaining, offset);
+		if (processed <= 0) break;
+		pixels += processed;
+		offset += processed;
+		remaining -= processed;
+	}
+	close(fd);
+	return remaining == 0;
+}
+
+/**
+* This method is used to create the P6 output file with its header and
+* full pixel size so that shards can write their rows in place.
+* It must run once before the shards start as resizing a file while
+* other processes write into it is not safe on shared storage.
+* @param *fname  Pointer to output file name
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @return int This returns 1 if the file was created or 0 otherwise.
+*/
+_Bool createShardedOutput(const char *fname, PPM *ppm)
+{
+	char header[MAX_HEADER];
+	int header_size = buildBinaryHeader(ppm, header);
+
+	int fd = open(fname, O_WRONLY | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Can't open %s file for writing \n", fname);
+		return FAILURE;
+	}
+	_Bool created = pwrite(fd, header, header_size, 0) == header_size
+		&& ftruncate(fd, (off_t)header_size + shardedPixelsSize(ppm)) == 0;
+	close(fd);
+	return created;
+}
+
+/**
+* This method is used to check that the output file was created for the image
+* by createShardedOutput before a shard writes into it
+* @param *fname  Pointer to output file name
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @return int This returns 1 if the file has the size of the image or 0 otherwise.
+*/
+_Bool checkShardedOutput(const char *fname, PPM *ppm)
+{
+	char header[MAX_HEADER];
+	struct stat output_stat;
+	return stat(fname, &output_stat) == 0
+		&& output_stat.st_size == (off_t)buildBinaryHeader(ppm, header) + shardedPixelsSize(ppm);
+}
+
+/**
+* This method is used to find the image rows of a shard. The block rows are split
+* evenly so that no block is shared between two shards.
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @param block_size  The mosaic cell size
+* @param shard_index  The index of the shard
+* @param shard_count  The number of shards
+* @param *first_row  The first image row of the shard
+* @param *rows  The number of image rows of the shard (0 if it has no block row)
+* @return void
+*/
+void shardRows(PPM *ppm, unsigned int block_size, unsigned int shard_index, unsigned int shard_count, unsigned int *first_row, unsigned int *rows)
+{
+	unsigned int height_blocks = (ppm->height + block_size - 1) / block_size;
+	unsigned int first = (unsigned int)((unsigned long long)shard_index * height_blocks / shard_count) * block_size;
+	unsigned int last = (unsigned int)((unsigned long long)(shard_index + 1) * height_blocks / shard_count) * block_size;
+	if (last > ppm->height) last = ppm->height;
+	*first_row = first;
+	*rows = last > first ? last - first : 0;
+}
+
+/**
+* This method is used to write the pixels of a range of image rows
+* in place inside an output file created by createShardedOutput.
+* @param *fname  Pointer to output file name
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @param first_row  The first image row to write
+* @param rows  The number of image rows to write
+* @param *pixels  Pointer to rows * width pixels to write
+* @return int This returns 1 if all the pixels were written or 0 otherwise.
+*/
+_Bool writePPMRows(const char *fname, PPM *ppm, unsigned int first_row, unsigned int rows, unsigned char *pixels)
+{
+	int fd = open(fname, O_WRONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Error: Can't open %s file for writing \n", fname);
+		return FAILURE;
+	}
+
+	char header[MAX_HEADER];
+	size_t row_size = (size_t)ppm->width * RGB_SIZE;
+	size_t remaining = row_size * rows;
+	off_t offset = buildBinaryHeader(ppm, header) + (off_t)first_row * row_size;
+	while (remaining > 0) {
+		ssize_t processed = pwrite(fd, pixels, remaining, offset);
+		if (processed <= 0) break;
+		pixels += processed;
+		offset += processed;
+		remaining -= processed;
+	}
+	close(fd);
+	return remaining == 0;
+}
+
+/**
+* This method is used to build the name of the file holding the partial sums of a shard
+* @param *fname  Pointer to output file name
+* @param shard_index  The index of the shard
+* @param *sums_name  Buffer receiving the name
+* @param sums_name_size  Size of the buffer
+* @return void
+*/
+void buildShardSumsName(const char *fname, unsigned int shard_index, char *sums_name, size_t sums_name_size)
+{
+	snprintf(sums_name, sums_name_size, "%s.shard%u", fname, shard_index);
+}
+
+/**
+* This method is used to save the partial global sums of a shard next to the output file.
+* The shard index, shard count, execution mode, block size and row range are saved
+* as well so that the merge can reject the sums of another run.
+* @param *fname  Pointer to output file name
+* @param shard_index  The index of the shard
+* @param shard_count  The number of shards
+* @param execution_mode  The mode of the kernel which computed the sums
+* @param block_size  The mosaic cell size
+* @param first_row  The first image row of the shard
+* @param rows  The number of image rows of the shard
+* @param *sums  The partial [r,g,b] sums of the shard
+* @return int This returns 1 if the sums were written or 0 otherwise.
+*/
+_Bool writeShardSums(const char *fname, unsigned int shard_index, unsigned int shard_count, MODE execution_mode, unsigned int block_size, unsigned int first_row, unsigned int rows, double *sums)
+{
+	char sums_name[FILENAME_MAX];
+	buildShardSumsName(fname, shard_index, sums_name, sizeof sums_name);
+	FILE *f = fopen(sums_name, "w");
+	if (f == NULL) {
+		fprintf(stderr, "Error: Can't open %s file for writing \n", sums_name);
+		return FAILURE;
+	}
+	_Bool written = fprintf(f, "%u %u %d %u %u %u %.17g %.17g %.17g\n", shard_index, shard_count, execution_mode, block_size, first_row, rows, sums[0], sums[1], sums[2]) > 0;
+	if (fclose(f) != 0) written = FAILURE;
+	return written;
+}
+
+/**
+* This method is used to remove the partial global sums of the shards
+* @param *fname  Pointer to output file name
+* @param shard_count  The number of shards
+* @return void
+*/
+void removeShardSums(const char *fname, unsigned int shard_count)
+{
+	for (unsigned int shard_index = 0; shard_index < shard_count; shard_index++) {
+		char sums_name[FILENAME_MAX];
+		buildShardSumsName(fname, shard_index, sums_name, sizeof sums_name);
+		remove(sums_name);
+	}
+}
+
+/**
+* This method is used to merge and remove the partial global sums of all the shards.
+* Every shard must have been run with the same shard count, execution mode and
+* block size and the shards must cover all the rows of the image, otherwise
+* nothing is merged or removed.
+* @param *fname  Pointer to output file name
+* @param *ppm  Pointer to PPM structure holding the header of the image
+* @param execution_mode  The mode the sums are merged for
+* @param block_size  The mosaic cell size
+* @param shard_count  The number of shards
+* @param *sums  The merged image [r,g,b] sums
+* @return int This returns 1 if the sums of every shard were merged or 0 otherwise.
+*/
+_Bool mergeShardSums(const char *fname, PPM *ppm, MODE execution_mode, unsigned int block_size, unsigned int shard_count, double *sums)
+{
+	unsigned long long merged_rows = 0;
+	sums[0] = sums[1] = sums[2] = 0;
+	for (unsigned int shard_index = 0; shard_index < shard_count; shard_index++) {
+		char sums_name[FILENAME_MAX];
+		buildShardSumsName(fname, shard_index, sums_name, sizeof sums_name);
+		FILE *f = fopen(sums_name, "r");
+		if (f == NULL) {
+			fprintf(stderr, "Error: Can't open %s file for reading\n", sums_name);
+			return FAILURE;
+		}
+		unsigned int saved_index = 0, saved_count = 0, saved_block_size = 0, first_row = 0, rows = 0;
+		int saved_mode = 0;
+		double r = 0, g = 0, b = 0;
+		int read_values = fscanf(f, "%u %u %d %u %u %u %lf %lf %lf", &saved_index, &saved_count, &saved_mode, &saved_block_size, &first_row, &rows, &r, &g, &b);
+		fclose(f);
+		if (read_values != 9) {
+			fprintf(stderr, "Error: Wrong partial sums in %s \n", sums_name);
+			return FAILURE;
+		}
+		if (saved_index != shard_index || saved_count != shard_count) {
+			fprintf(stderr, "Error: %s was written by shard %u/%u instead of %u/%u \n", sums_name, saved_index, saved_count, shard_index, shard_count);
+			return FAILURE;
+		}
+		if (saved_mode != (int)execution_mode || saved_block_size != block_size) {
+			fprintf(stderr, "Error: %s was computed with mode %d and block size %u instead of mode %d and block size %u \n", sums_name, saved_mode, saved_block_size, execution_mode, block_size);
+			return FAILURE;
+		}
+		unsigned int expected_first_row, expected_rows;
+		shardRows(ppm, block_size, shard_index, shard_count, &expected_first_row, &expected_rows);
+		if (first_row != expected_first_row || rows != expected_rows) {
+			fprintf(stderr, "Error: %s holds rows %u to %u instead of %u to %u \n", sums_name, first_row, first_row + rows, expected_first_row, expected_first_row + expected_rows);
+			return FAILURE;
+		}
+		merged_rows += rows;
+		sums[0] += r;
+		sums[1] += g;
+		sums[2] += b;
+	}
+	unsigned long long pixels_count = (unsigned long long)ppm->width * ppm->height;
+	if (merged_rows * ppm->width != pixels_count) {
+		fprintf(stderr, "Error: The shards cover %llu of the %llu image pixels \n", merged_rows * ppm->width, pixels_count);
+		return FAILURE;
+	}
+
+	// remove the partial sums only once all of them were merged so a failed merge can be retried
+	removeShardSums(fname, shard_count);
+	return SUCCESS;
+}
+#endif
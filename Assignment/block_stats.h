@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Max number of luminance histogram bins kept per block
+#define MAX_HISTOGRAM_BINS	256
+
+// Possible block statistics output formats
+typedef enum STATS_FORMAT { STATS_CSV, STATS_BINARY } STATS_FORMAT;
+
+// Structure used to hold the statistics of a single mosaic block
+typedef struct BLOCK_STAT
+{
+	unsigned int width, height;
+	unsigned long long sum[RGB_SIZE], sumSquares[RGB_SIZE];
+	unsigned char min[RGB_SIZE], max[RGB_SIZE];
+} BLOCK_STAT;
+
+// Structure used to hold the statistics grid of all the mosaic blocks
+typedef struct BLOCK_STATS
+{
+	unsigned int width_blocks, height_blocks, block_size, histogram_bins;
+	BLOCK_STAT *blocks;
+	// histogram_bins counters per block stored one block after the other
+	unsigned int *histograms;
+} BLOCK_STATS;
+
+/**
+* This method is used to allocate the statistics grid for an image
+* @param width  Image width in pixels
+* @param height  Image height in pixels
+* @param block_size  The mosaic cell size
+* @param histogram_bins  Number of luminance histogram bins per block (0 to disable)
+* @return BLOCK_STATS* Pointer to the allocated statistics or NULL on failure
+*/
+BLOCK_STATS *allocateBlockStats(unsigned int width, unsigned int height, unsigned int block_size, unsigned int histogram_bins)
+{
+	BLOCK_STATS *stats = (BLOCK_STATS *)malloc(sizeof(BLOCK_STATS));
+	if (stats == NULL) return NULL;
+
+	// count the incomplete width/height blocks as well
+	stats->width_blocks = (width + block_size - 1) / block_size;
+	stats->height_blocks = (height + block_size - 1) / block_size;
+	stats->block_size = block_size;
+	stats->histogram_bins = histogram_bins;
+
+	unsigned int blocks_count = stats->width_blocks * stats->height_blocks;
+	stats->blocks = (BLOCK_STAT *)calloc(blocks_count, sizeof(BLOCK_STAT));
+	stats->histograms = histogram_bins ? (unsigned int *)calloc((size_t)blocks_count * histogram_bins, sizeof(unsigned int)) : NULL;
+	if (stats->blocks == NULL || (histogram_bins && stats->histograms == NULL)) {
+		free(stats->blocks);
+		free(stats->histograms);
+		free(stats);
+		return NULL;
+	}
+	return stats;
+}
+
+/**
+* This method is used to free the statistics grid
+* @param *stats  Pointer to BLOCK_STATS structure
+* @return void
+*/
+void freeBlockStats(BLOCK_STATS *stats)
+{
+	if (stats == NULL) return;
+	free(stats->blocks);
+	free(stats->histograms);
+	free(stats);
+}
+
+/**
+* This method is used to find the luminance histogram bin of a pixel
+* @param r, g, b  The pixel values
+* @param histogram_bins  Number of histogram bins
+* @return unsigned int The index of the bin
+*/
+static inline unsigned int luminanceBin(int r, int g, int b, unsigned int histogram_bins)
+{
+	// integer approximation of the Rec. 601 luma in the 0-255 range
+	unsigned int luma = (77 * r + 150 * g + 29 * b) >> 8;
+	return luma * histogram_bins >> 8;
+}
+
+/**
+* This method is used to accumulate the statistics of a block in the same pass as the
+* mosaic reads it. The values are kept in local variables and stored once the block
+* is complete as the histogram stores could otherwise alias them.
+* @param *stat  Pointer to BLOCK_STAT structure of the block
+* @param *histogram  Pointer to the block histogram (NULL if disabled)
+* @param histogram_bins  Number of histogram bins
+* @param *block_pixels  Pointer to the first pixel of the block
+* @param width, height  Size of the (possibly incomplete) block
+* @param row_stride  Number of bytes between two image rows
+* @return void
+*/
+static inline void accumulateBlockStat(BLOCK_STAT *stat, unsigned int *histogram, unsigned int histogram_bins,
+	const unsigned char *block_pixels, unsigned int width, unsigned int height, size_t row_stride)
+{
+	unsigned long long sumR = 0, sumG = 0, sumB = 0;
+	unsigned long long sumSquaresR = 0, sumSquaresG = 0, sumSquaresB = 0;
+	int minR = 255, minG = 255, minB = 255, maxR = 0, maxG = 0, maxB = 0;
+	for (unsigned int block_h = 0; block_h < height; block_h++) {
+		const unsigned char *pixel = block_pixels + block_h * row_stride;
+		for (unsigned int block_w = 0; block_w < width; block_w++, pixel += RGB_SIZE) {
+			int r = pixel[0];
+			int g = pixel[1];
+			int b = pixel[2];
+
+			sumR += r;
+			sumG += g;
+			sumB += b;
+			sumSquaresR += r * r;
+			sumSquaresG += g * g;
+			sumSquaresB += b * b;
+			minR = r < minR ? r : minR;
+			minG = g < minG ? g : minG;
+			minB = b < minB ? b : minB;
+			maxR = r > maxR ? r : maxR;
+			maxG = g > maxG ? g : maxG;
+			maxB = b > maxB ? b : maxB;
+			if (histogram != NULL) histogram[luminanceBin(r, g, b, histogram_bins)]++;
+		}
+	}
+
+	stat->width = width;
+	stat->height = height;
+	stat->sum[0] = sumR;
+	stat->sum[1] = sumG;
+	stat->sum[2] = sumB;
+	stat->sumSquares[0] = sumSquaresR;
+	stat->sumSquares[1] = sumSquaresG;
+	stat->sumSquares[2] = sumSquaresB;
+	stat->min[0] = minR;
+	stat->min[1] = minG;
+	stat->min[2] = minB;
+	stat->max[0] = maxR;
+	stat->max[1] = maxG;
+	stat->max[2] = maxB;
+}
+
+/**
+* This method is used to write the statistics grid to file either as
+* CSV (one row per block) or as a compact binary grid.
+* The binary layout is the "BSTA" magic followed by width_blocks, height_blocks,
+* block_size and histogram_bins as unsigned ints, then for every block in row order:
+* width, height, sum[3], sumSquares[3], min[3], max[3], histogram[histogram_bins]
+* in native byte order.
+* @param *fname  Pointer to output file name
+* @param *stats  Pointer to BLOCK_STATS structure
+* @param stats_format  The writing format of the statistics
+* @return int This returns 1 if all the blocks were written or 0 otherwise.
+*/
+_Bool writeBlockStats(const char *fname, BLOCK_STATS *stats, STATS_FORMAT stats_format)
+{
+	FILE *f = fopen(fname, stats_format == STATS_BINARY ? "wb" : "w");
+	if (f == NULL) {
+		fprintf(stderr, "Error: Can't open %s file for writing \n", fname);
+		return FAILURE;
+	}
+
+	unsigned int blocks_count = stats->width_blocks * stats->height_blocks;
+	unsigned int written_blocks = 0;
+	if (stats_format == STATS_BINARY) {
+		unsigned int header[4] = { stats->width_blocks, stats->height_blocks, stats->block_size, stats->histogram_bins };
+		// every block is counted only once all of its fields were written
+		_Bool written = fwrite("BSTA", sizeof(char), 4, f) == 4
+			&& fwrite(header, sizeof(unsigned int), 4, f) == 4;
+		for (unsigned int i = 0; written && i < blocks_count; i++) {
+			BLOCK_STAT *stat = &stats->blocks[i];
+			written = fwrite(&stat->width, sizeof(unsigned int), 1, f) == 1
+				&& fwrite(&stat->height, sizeof(unsigned int), 1, f) == 1
+				&& fwrite(stat->sum, sizeof(unsigned long long), RGB_SIZE, f) == RGB_SIZE
+				&& fwrite(stat->sumSquares, sizeof(unsigned long long), RGB_SIZE, f) == RGB_SIZE
+				&& fwrite(stat->min, sizeof(unsigned char), RGB_SIZE, f) == RGB_SIZE
+				&& fwrite(stat->max, sizeof(unsigned char), RGB_SIZE, f) == RGB_SIZE
+				&& (!stats->histogram_bins || fwrite(&stats->histograms[(size_t)i * stats->histogram_bins], sizeof(unsigned int), stats->histogram_bins, f) == stats->histogram_bins);
+			if (written) written_blocks++;
+		}
+	}
+	else {
+		fprintf(f, "block_x,block_y,width,height,mean_r,mean_g,mean_b,variance_r,variance_g,variance_b,min_r,min_g,min_b,max_r,max_g,max_b");
+		for (unsigned int bin = 0; bin < stats->histogram_bins; bin++)
+			fprintf(f, ",hist_%u", bin);
+		fprintf(f, "\n");
+
+		for (unsigned int i = 0; i < blocks_count; i++) {
+			BLOCK_STAT *stat = &stats->blocks[i];
+			double count = (double)stat->width * stat->height;
+			fprintf(f, "%u,%u,%u,%u", i % stats->width_blocks, i / stats->width_blocks, stat->width, stat->height);
+			for (int c = 0; c < RGB_SIZE; c++)
+				fprintf(f, ",%.3f", stat->sum[c] / count);
+			// population variance E[x^2] - E[x]^2
+			for (int c = 0; c < RGB_SIZE; c++) {
+				double mean = stat->sum[c] / count;
+				fprintf(f, ",%.3f", stat->sumSquares[c] / count - mean * mean);
+			}
+			for (int c = 0; c < RGB_SIZE; c++)
+				fprintf(f, ",%d", stat->min[c]);
+			for (int c = 0; c < RGB_SIZE; c++)
+				fprintf(f, ",%d", stat->max[c]);
+			for (unsigned int bin = 0; bin < stats->histogram_bins; bin++)
+				fprintf(f, ",%u", stats->histograms[(size_t)i * stats->histogram_bins + bin]);
+			if (fprintf(f, "\n") < 0) break;
+			written_blocks++;
+		}
+	}
+
+	// buffered writes can still fail when they are flushed
+	_Bool flushed = !ferror(f);
+	if (fclose(f) != 0) flushed = FAILURE;
+	return flushed && written_blocks == blocks_count;
+}
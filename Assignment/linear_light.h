@@ -0,0 +1,87 @@
+#include <math.h>
+
+// Number of entries of the sRGB decoding table, one per possible 8 bit value
+#define LINEAR_TABLE_SIZE	256
+// Max value of a linear light sample in the decoding table
+#define LINEAR_MAX	65535
+
+// Possible block averaging modes
+typedef enum AVERAGING_MODE { AVERAGE_SRGB, AVERAGE_LINEAR } AVERAGING_MODE;
+
+// Table used to decode sRGB encoded pixel values into 16 bit linear light values
+static unsigned short linear_table[LINEAR_TABLE_SIZE];
+// Number of valid entries in the table (maxColor + 1)
+static unsigned int linear_table_size = 0;
+
+/**
+* This method is used to build the sRGB to linear light decoding table
+* so that the mosaic kernels do not have to call pow for every sample.
+* @param maxColor  The max color value of the image
+* @return void
+*/
+void buildLinearTable(unsigned int maxColor)
+{
+	if (maxColor >= LINEAR_TABLE_SIZE) maxColor = LINEAR_TABLE_SIZE - 1;
+	for (unsigned int v = 0; v <= maxColor; v++) {
+		double encoded = (double)v / maxColor;
+		double linear = encoded <= 0.04045 ? encoded / 12.92 : pow((encoded + 0.055) / 1.055, 2.4);
+		linear_table[v] = (unsigned short)(linear * LINEAR_MAX + 0.5);
+	}
+	linear_table_size = maxColor + 1;
+}
+
+/**
+* This method is used to encode a linear light value back to sRGB by a
+* binary search over the decoding table for the nearest encoded value.
+* It is called once per block and channel so its cost does not depend on the block size.
+* @param linear  The linear light value between 0 and LINEAR_MAX
+* @return unsigned char The nearest sRGB encoded value
+*/
+unsigned char encodeLinear(unsigned int linear)
+{
+	// find the last table entry which is not greater than the linear value
+	unsigned int low = 0, high = linear_table_size - 1;
+	while (low < high) {
+		unsigned int middle = (low + high + 1) / 2;
+		if (linear_table[middle] <= linear) low = middle;
+		else high = middle - 1;
+	}
+	// the next entry can be nearer to the linear value
+	if (low + 1 < linear_table_size && linear_table[low + 1] - linear < linear - linear_table[low]) low++;
+	return (unsigned char)low;
+}
+
+/**
+* This method is used to accumulate the sums and the linear light sums of a block
+* in the same pass as the mosaic reads it
+* @param *sums  The [r,g,b] sums of the block
+* @param *linear_sums  The [r,g,b] linear light sums of the block
+* @param *block_pixels  Pointer to the first pixel of the block
+* @param width, height  Size of the (possibly incomplete) block
+* @param row_stride  Number of bytes between two image rows
+* @return void
+*/
+static inline void accumulateLinearSums(unsigned long long *sums, unsigned long long *linear_sums,
+	const unsigned char *block_pixels, unsigned int width, unsigned int height, size_t row_stride)
+{
+	unsigned long long sumR = 0, sumG = 0, sumB = 0;
+	unsigned long long linearSumR = 0, linearSumG = 0, linearSumB = 0;
+	for (unsigned int block_h = 0; block_h < height; block_h++) {
+		const unsigned char *pixel = block_pixels + block_h * row_stride;
+		for (unsigned int block_w = 0; block_w < width; block_w++, pixel += RGB_SIZE) {
+			sumR += pixel[0];
+			sumG += pixel[1];
+			sumB += pixel[2];
+			linearSumR += linear_table[pixel[0]];
+			linearSumG += linear_table[pixel[1]];
+			linearSumB += linear_table[pixel[2]];
+		}
+	}
+
+	sums[0] = sumR;
+	sums[1] = sumG;
+	sums[2] = sumB;
+	linear_sums[0] = linearSumR;
+	linear_sums[1] = linearSumG;
+	linear_sums[2] = linearSumB;
+}
@@ -4,6 +4,12 @@
 #include <omp.h>
 #include <math.h>
 #include "PPM_read_write.h"
+#include "block_stats.h"
+#include "PPM_shard.h"
+#include "linear_light.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
 
 #define USER_NAME "aca14dbt"
 
@@ -14,6 +20,13 @@ void print_help();
 void CPU_mosaic(PPM *ppm);
 void OPENMP_mosaic(PPM *ppm);
 void freePPMAllocatedMemory(PPM *ppm);
+void createBlockStats(PPM *ppm);
+void saveBlockStats();
+_Bool readShardedHeader(PPM *header);
+_Bool createShards();
+_Bool runShard(unsigned int index);
+_Bool launchShards();
+_Bool mergeShards();
 
 // global variables
 unsigned int block_size = 0;
@@ -25,10 +38,41 @@ double openmp_begin, openmp_end, seconds;
 MODE execution_mode = CPU;
 OUTPUT_FORMAT output_format = PPM_BINARY;
 
+// averaging of the block pixels either on the sRGB encoded values or in linear light
+AVERAGING_MODE averaging_mode = AVERAGE_SRGB;
+
+// optional per block statistics computed during the mosaic pass
+char *stats_file_name = NULL;
+STATS_FORMAT stats_format = STATS_CSV;
+unsigned int histogram_bins = 0;
+BLOCK_STATS *block_stats = NULL;
+
+// optional sharded execution over several processes
+SHARD_MODE shard_mode = SHARD_NONE;
+unsigned int shard_index = 0, shard_count = 0;
+
+// image [r,g,b] sums computed by the last mosaic pass
+double global_sum[RGB_SIZE];
+
 int main(int argc, char *argv[]) {
 	if (process_command_line(argc, argv) == FAILURE)
 		return 1;
 
+#ifndef _WIN32
+	switch (shard_mode) {
+	case (SHARD_CREATE):
+		return createShards() ? 0 : 1;
+	case (SHARD_WORKER):
+		return runShard(shard_index) ? 0 : 1;
+	case (SHARD_LAUNCH):
+		return launchShards() ? 0 : 1;
+	case (SHARD_MERGE):
+		return mergeShards() ? 0 : 1;
+	case (SHARD_NONE):
+		break;
+	}
+#endif
+
 	switch (execution_mode) {
 	case (CPU): {
 
@@ -39,8 +83,10 @@ int main(int argc, char *argv[]) {
 		// read the PPM file and store it into the struct
 		if (readPPM(input_image_name, ppm)) {
 			printf("Image width is %d and height is %d \n", ppm->width, ppm->height);
+			createBlockStats(ppm);
 			// compute the cpu mosaic
 			CPU_mosaic(ppm);
+			saveBlockStats();
 
 			// write to file
 			if (!writeToFile(output_image_name, ppm, output_format, execution_mode)) fprintf(stderr, "Error: Could not write all the pixels \n");
@@ -60,9 +106,10 @@ int main(int argc, char *argv[]) {
 
 		// read the PPM file and store it into the struct
 		if (readPPM(input_image_name, ppm)) {
-
+			createBlockStats(ppm);
 			// compute the openmp mosaic
 			OPENMP_mosaic(ppm);
+			saveBlockStats();
 
 			// write to file
 			if (!writeToFile(output_image_name, ppm, output_format, execution_mode)) fprintf(stderr, "Error: Could not write all the pixels \n");
@@ -94,8 +141,12 @@ int main(int argc, char *argv[]) {
 			ppm->outputPixels = malloc(sizeof(char)*ppm->size);
 			memset(ppm->outputPixels, 0, ppm->size);
 
+			// the block statistics are collected during the CPU pass as it is the one reading the input pixels
+			createBlockStats(ppm);
+
 			// CPU mosaic
 			CPU_mosaic(ppm);
+			saveBlockStats();
 
 			// OPENMP mosaic
 			OPENMP_mosaic(ppm);
@@ -157,6 +208,29 @@ void freePPMAllocatedMemory(PPM *ppm) {
 		free(ppm);
 }
 
+/**
+* This method is used to allocate the per block statistics if a stats file was requested
+* @param *ppm  Pointer to PPM structure
+* @return void
+*/
+void createBlockStats(PPM *ppm) {
+	if (stats_file_name == NULL) return;
+	block_stats = allocateBlockStats(ppm->width, ppm->height, block_size, histogram_bins);
+	if (block_stats == NULL) fprintf(stderr, "Error: Could not allocate the block statistics \n");
+}
+
+/**
+* This method is used to write and free the per block statistics computed by the last mosaic pass
+* @return void
+*/
+void saveBlockStats() {
+	if (block_stats == NULL) return;
+	if (!writeBlockStats(stats_file_name, block_stats, stats_format)) fprintf(stderr, "Error: Could not write all the block statistics \n");
+	else printf("Info: Your %s statistics file was successfully created \n", stats_file_name);
+	freeBlockStats(block_stats);
+	block_stats = NULL;
+}
+
 /**
 * This method is used to compute the mosaic functionality using CPU
 * @param *ppm  Pointer to PPM structure
@@ -167,9 +241,11 @@ void CPU_mosaic(PPM *ppm) {
 	//starting CPU timing here after the file was read
 	begin = clock();
 	openmp_begin = omp_get_wtime();
+	// decode table used when averaging in linear light
+	if (averaging_mode == AVERAGE_LINEAR) buildLinearTable(ppm->maxColor);
 
 	// global method to hold the pixel[r,g,b] values
-	unsigned int globalSumR = 0, globalSumG = 0, globalSumB = 0;
+	unsigned long long globalSumR = 0, globalSumG = 0, globalSumB = 0;
 	/*
 	A complete width/height block is a square with sides equals to the input
 	block_size.
@@ -205,29 +281,65 @@ void CPU_mosaic(PPM *ppm) {
 				dynamic_block_height = ppm->height - height_block * block_size;
 			}
 			// variables used to store the local sum
-			int localSumR = 0, localSumG = 0, localSumB = 0;
-			// iterate over block cells
-			for (unsigned int block_h = 0; block_h < dynamic_block_height; block_h++)
-				for (unsigned int block_w = 0; block_w < dynamic_block_width; block_w++) {
-					// access the pixel within the block
-					int i = height_block * block_size * ppm->width + width_block * block_size + block_w + ppm->width*block_h;
-
-					int r = ppm->pixels[i*RGB_SIZE];
-					int g = ppm->pixels[i*RGB_SIZE + 1];
-					int b = ppm->pixels[i*RGB_SIZE + 2];
-
-					// add the value to the local block sum
-					localSumR += r;
-					localSumG += g;
-					localSumB += b;
-
-					// add the value to the global block sum
-					globalSumR += r;
-					globalSumG += g;
-					globalSumB += b;
+			unsigned long long localSumR = 0, localSumG = 0, localSumB = 0;
+			// variables used to store the local linear light sum
+			unsigned long long linearSum[RGB_SIZE] = { 0, 0, 0 };
+			// iterate over block cells, the statistics and the linear light sums are
+			// accumulated by their own helpers so that the plain mosaic does not pay for them
+			if (block_stats == NULL && averaging_mode == AVERAGE_SRGB) {
+				for (unsigned int block_h = 0; block_h < dynamic_block_height; block_h++)
+					for (unsigned int block_w = 0; block_w < dynamic_block_width; block_w++) {
+						// access the pixel within the block
+						int i = height_block * block_size * ppm->width + width_block * block_size + block_w + ppm->width*block_h;
+
+						int r = ppm->pixels[i*RGB_SIZE];
+						int g = ppm->pixels[i*RGB_SIZE + 1];
+						int b = ppm->pixels[i*RGB_SIZE + 2];
+
+						// add the value to the local block sum
+						localSumR += r;
+						localSumG += g;
+						localSumB += b;
+
+						// add the value to the global block sum
+						globalSumR += r;
+						globalSumG += g;
+						globalSumB += b;
+					}
+			}
+			else {
+				const unsigned char *block_pixels = &ppm->pixels[((size_t)height_block * block_size * ppm->width + width_block * block_size) * RGB_SIZE];
+				size_t row_stride = (size_t)ppm->width * RGB_SIZE;
+				unsigned long long blockSum[RGB_SIZE];
+				if (block_stats != NULL) {
+					unsigned int block_index = height_block * width_blocks + width_block;
+					unsigned int *histogram = histogram_bins ? &block_stats->histograms[(size_t)block_index * histogram_bins] : NULL;
+					accumulateBlockStat(&block_stats->blocks[block_index], histogram, histogram_bins, block_pixels, dynamic_block_width, dynamic_block_height, row_stride);
+					memcpy(blockSum, block_stats->blocks[block_index].sum, sizeof blockSum);
 				}
+				if (averaging_mode == AVERAGE_LINEAR)
+					accumulateLinearSums(blockSum, linearSum, block_pixels, dynamic_block_width, dynamic_block_height, row_stride);
+				localSumR = blockSum[0];
+				localSumG = blockSum[1];
+				localSumB = blockSum[2];
+
+				// add the block sum to the global sum
+				globalSumR += blockSum[0];
+				globalSumG += blockSum[1];
+				globalSumB += blockSum[2];
+			}
 			// compute the number of pixels within the block
 			int average_dynamic_size = dynamic_block_width * dynamic_block_height;
+			// compute the local block average rgb values
+			int average_red = localSumR / average_dynamic_size;
+			int average_green = localSumG / average_dynamic_size;
+			int average_blue = localSumB / average_dynamic_size;
+			// average in linear light and encode the result back to sRGB
+			if (averaging_mode == AVERAGE_LINEAR) {
+				average_red = encodeLinear((unsigned int)((linearSum[0] + average_dynamic_size / 2) / average_dynamic_size));
+				average_green = encodeLinear((unsigned int)((linearSum[1] + average_dynamic_size / 2) / average_dynamic_size));
+				average_blue = encodeLinear((unsigned int)((linearSum[2] + average_dynamic_size / 2) / average_dynamic_size));
+			}
 
 			char *pixels;
 			// if the execution mode is ALL use the outputPixel array for saving the modifications
@@ -241,13 +353,16 @@ void CPU_mosaic(PPM *ppm) {
 					// access the pixel within the block
 					int i = height_block * block_size * ppm->width + width_block * block_size + block_w + ppm->width*block_h;
 
-					ppm->pixels[i * RGB_SIZE] = localSumR / average_dynamic_size;
-					ppm->pixels[i * RGB_SIZE + 1] = localSumG / average_dynamic_size;
-					ppm->pixels[i * RGB_SIZE + 2] = localSumB / average_dynamic_size;
+					ppm->pixels[i * RGB_SIZE] = average_red;
+					ppm->pixels[i * RGB_SIZE + 1] = average_green;
+					ppm->pixels[i * RGB_SIZE + 2] = average_blue;
 				}
 		}
 
-	printf("CPU Average image colour red = %d, green = %d, blue = %d \n", globalSumR / ppm->pixels_count, globalSumG / ppm->pixels_count, globalSumB / ppm->pixels_count);
+	printf("CPU Average image colour red = %llu, green = %llu, blue = %llu \n", globalSumR / ppm->pixels_count, globalSumG / ppm->pixels_count, globalSumB / ppm->pixels_count);
+	global_sum[0] = (double)globalSumR;
+	global_sum[1] = (double)globalSumG;
+	global_sum[2] = (double)globalSumB;
 
 	//end timing here
 	end = clock();
@@ -269,6 +384,8 @@ void OPENMP_mosaic(PPM *ppm) {
 	//starting OPENMP timing here after the file was read
 	begin = clock();
 	openmp_begin = omp_get_wtime();
+	// decode table used when averaging in linear light
+	if (averaging_mode == AVERAGE_LINEAR) buildLinearTable(ppm->maxColor);
 
 	// global method to hold the pixel[r,g,b] values
 	float globalSumR = 0, globalSumG = 0, globalSumB = 0;
@@ -309,22 +426,43 @@ void OPENMP_mosaic(PPM *ppm) {
 				dynamic_block_height = ppm->height - height_block * block_size;
 			}
 			// variables used to store the local sum
-			int localSumR = 0, localSumG = 0, localSumB = 0;
-			// iterate over block cells
-			for (unsigned int block_h = 0; block_h < dynamic_block_height; block_h++)
-				for (unsigned int block_w = 0; block_w < dynamic_block_width; block_w++) {
-					// access the pixel within the block
-					int i = height_block * block_size * ppm->width + width_block * block_size + block_w + ppm->width*block_h;
-
-					int r = ppm->pixels[i*RGB_SIZE];
-					int g = ppm->pixels[i*RGB_SIZE + 1];
-					int b = ppm->pixels[i*RGB_SIZE + 2];
-
-					// add the value to the local block sum
-					localSumR += r;
-					localSumG += g;
-					localSumB += b;
+			unsigned long long localSumR = 0, localSumG = 0, localSumB = 0;
+			// variables used to store the local linear light sum
+			unsigned long long linearSum[RGB_SIZE] = { 0, 0, 0 };
+			// iterate over block cells, the statistics and the linear light sums are
+			// accumulated by their own helpers so that the plain mosaic does not pay for them
+			if (block_stats == NULL && averaging_mode == AVERAGE_SRGB) {
+				for (unsigned int block_h = 0; block_h < dynamic_block_height; block_h++)
+					for (unsigned int block_w = 0; block_w < dynamic_block_width; block_w++) {
+						// access the pixel within the block
+						int i = height_block * block_size * ppm->width + width_block * block_size + block_w + ppm->width*block_h;
+
+						int r = ppm->pixels[i*RGB_SIZE];
+						int g = ppm->pixels[i*RGB_SIZE + 1];
+						int b = ppm->pixels[i*RGB_SIZE + 2];
+
+						// add the value to the local block sum
+						localSumR += r;
+						localSumG += g;
+						localSumB += b;
+					}
+			}
+			else {
+				const unsigned char *block_pixels = &ppm->pixels[((size_t)height_block * block_size * ppm->width + width_block * block_size) * RGB_SIZE];
+				size_t row_stride = (size_t)ppm->width * RGB_SIZE;
+				unsigned long long blockSum[RGB_SIZE];
+				if (block_stats != NULL) {
+					unsigned int block_index = height_block * width_blocks + width_block;
+					unsigned int *histogram = histogram_bins ? &block_stats->histograms[(size_t)block_index * histogram_bins] : NULL;
+					accumulateBlockStat(&block_stats->blocks[block_index], histogram, histogram_bins, block_pixels, dynamic_block_width, dynamic_block_height, row_stride);
+					memcpy(blockSum, block_stats->blocks[block_index].sum, sizeof blockSum);
 				}
+				if (averaging_mode == AVERAGE_LINEAR)
+					accumulateLinearSums(blockSum, linearSum, block_pixels, dynamic_block_width, dynamic_block_height, row_stride);
+				localSumR = blockSum[0];
+				localSumG = blockSum[1];
+				localSumB = blockSum[2];
+			}
 			// compute the number of pixels within the block
 			int average_dynamic_size = dynamic_block_width * dynamic_block_height;
 			// compute the local block average rgb values
@@ -341,6 +479,13 @@ void OPENMP_mosaic(PPM *ppm) {
 			globalSumG += average_green * percentage;
 #pragma omp atomic
 			globalSumB += average_blue * percentage;
+			// the global average above stays on the encoded values, only the block colour
+			// is averaged in linear light and encoded back to sRGB
+			if (averaging_mode == AVERAGE_LINEAR) {
+				average_red = encodeLinear((unsigned int)((linearSum[0] + average_dynamic_size / 2) / average_dynamic_size));
+				average_green = encodeLinear((unsigned int)((linearSum[1] + average_dynamic_size / 2) / average_dynamic_size));
+				average_blue = encodeLinear((unsigned int)((linearSum[2] + average_dynamic_size / 2) / average_dynamic_size));
+			}
 			char *pixels;
 			// if the execution mode is ALL use the outputPixel array for saving the modifications
 			if (execution_mode == ALL)
@@ -362,6 +507,9 @@ void OPENMP_mosaic(PPM *ppm) {
 	}
 
 	printf("OPENMP Average image colour red = %0.0f, green = %0.0f, blue = %0.0f \n", round(globalSumR), round(globalSumG), round(globalSumB));
+	global_sum[0] = (double)globalSumR * ppm->pixels_count;
+	global_sum[1] = (double)globalSumG * ppm->pixels_count;
+	global_sum[2] = (double)globalSumB * ppm->pixels_count;
 
 	//end timing here
 	end = clock();
@@ -373,6 +521,159 @@ void OPENMP_mosaic(PPM *ppm) {
 
 }
 
+#ifndef _WIN32
+/**
+* This method is used to read and check the header of the input image of the shards
+* @param *header  Pointer to PPM structure receiving the header
+* @return int 1 if success and 0 if failure
+*/
+_Bool readShardedHeader(PPM *header) {
+	memset(header, 0, sizeof(PPM));
+	if (!readPPMHeader(input_image_name, header) || header->width == 0 || header->height == 0) {
+		fprintf(stderr, "Error: Could not read the header of %s \n", input_image_name);
+		return FAILURE;
+	}
+	if (header->tag != PPM_BINARY || header->maxColor > 255) {
+		fprintf(stderr, "Error: Shard mode requires a P6 input image with a max color of at most 255 \n");
+		return FAILURE;
+	}
+	checkBlockSize(header);
+	return SUCCESS;
+}
+
+/**
+* This method is used to create and size the output file once before the shards
+* are started and to remove the partial sums left by an earlier run
+* @return int 1 if success and 0 if failure
+*/
+_Bool createShards() {
+	PPM header;
+	if (!readShardedHeader(&header)) return FAILURE;
+	if (!createShardedOutput(output_image_name, &header)) {
+		fprintf(stderr, "Error: Could not create the %s output file \n", output_image_name);
+		return FAILURE;
+	}
+	removeShardSums(output_image_name, shard_count);
+	printf("Info: Your %s file was created for %d shards \n", output_image_name, shard_count);
+	return SUCCESS;
+}
+
+/**
+* This method is used to mosaic the block rows of one shard. Only the rows of the
+* shard are read from the input and written in place inside the output file
+* created by createShards, the partial global sums are saved next to the output
+* file for mergeShards.
+* @param index  The index of the shard between 0 and shard_count - 1
+* @return int 1 if success and 0 if failure
+*/
+_Bool runShard(unsigned int index) {
+	PPM header;
+	if (!readShardedHeader(&header)) return FAILURE;
+	if (!checkShardedOutput(output_image_name, &header)) {
+		fprintf(stderr, "Error: %s must be created with --create before running the shards \n", output_image_name);
+		return FAILURE;
+	}
+
+	unsigned int first_row, rows;
+	shardRows(&header, block_size, index, shard_count, &first_row, &rows);
+	printf("Info: Shard %d/%d -> rows %d to %d \n", index, shard_count, first_row, first_row + rows);
+	// the rows of a shard are held in memory with the 32 bit sizes of the PPM structure
+	if ((unsigned long long)header.width * rows * RGB_SIZE > UINT_MAX) {
+		fprintf(stderr, "Error: Shard %d/%d is larger than 4 GiB, please use more shards \n", index, shard_count);
+		return FAILURE;
+	}
+
+	double sums[RGB_SIZE] = { 0, 0, 0 };
+	if (rows > 0) {
+		// the shard is mosaicked as an image made only of its rows
+		PPM *ppm = (PPM *)malloc(sizeof(PPM));
+		*ppm = header;
+		ppm->height = rows;
+		ppm->pixels_count = ppm->width * rows;
+		ppm->size = ppm->pixels_count * RGB_SIZE;
+		ppm->pixels = malloc(sizeof(char)*ppm->size);
+		ppm->outputPixels = NULL;
+
+		if (!readPPMRows(input_image_name, &header, first_row, rows, ppm->pixels)) {
+			fprintf(stderr, "Error: Could not read all the pixels \n");
+			freePPMAllocatedMemory(ppm);
+			return FAILURE;
+		}
+
+		if (execution_mode == OPENMP) OPENMP_mosaic(ppm);
+		else CPU_mosaic(ppm);
+
+		_Bool written = writePPMRows(output_image_name, &header, first_row, rows, ppm->pixels);
+		for (int c = 0; c < RGB_SIZE; c++)
+			sums[c] = global_sum[c];
+		freePPMAllocatedMemory(ppm);
+		if (!written) {
+			fprintf(stderr, "Error: Could not write all the pixels \n");
+			return FAILURE;
+		}
+	}
+
+	return writeShardSums(output_image_name, index, shard_count, execution_mode, block_size, first_row, rows, sums);
+}
+
+/**
+* This method is used to create the output file, fork one local worker process
+* per shard, wait for all of them and merge their partial global sums
+* @return int 1 if success and 0 if failure
+*/
+_Bool launchShards() {
+	// the output is sized once here so that no worker resizes it while others write
+	if (!createShards()) return FAILURE;
+
+	_Bool success = SUCCESS;
+	// flush the already printed info so that it is not duplicated by the workers
+	fflush(stdout);
+	for (unsigned int index = 0; index < shard_count; index++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			_Bool shard_success = runShard(index);
+			fflush(stdout);
+			_exit(shard_success ? 0 : 1);
+		}
+		if (pid < 0) {
+			fprintf(stderr, "Error: Could not start the worker of shard %d \n", index);
+			success = FAILURE;
+		}
+	}
+
+	int status;
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) success = FAILURE;
+	}
+	if (!success) {
+		fprintf(stderr, "Error: Not all the shards were successfully mosaicked \n");
+		return FAILURE;
+	}
+
+	return mergeShards();
+}
+
+/**
+* This method is used to merge the partial global sums written by all the shards
+* and print the image average the same way the mode of the shards does
+* @return int 1 if success and 0 if failure
+*/
+_Bool mergeShards() {
+	PPM header;
+	if (!readShardedHeader(&header)) return FAILURE;
+	if (!mergeShardSums(output_image_name, &header, execution_mode, block_size, shard_count, global_sum)) return FAILURE;
+
+	unsigned long long pixels_count = (unsigned long long)header.width * header.height;
+	if (execution_mode == OPENMP)
+		printf("SHARDED Average image colour red = %0.0f, green = %0.0f, blue = %0.0f \n", round(global_sum[0] / pixels_count), round(global_sum[1] / pixels_count), round(global_sum[2] / pixels_count));
+	// the CPU sums are integers so they are truncated like in CPU_mosaic
+	else
+		printf("SHARDED Average image colour red = %llu, green = %llu, blue = %llu \n", (unsigned long long)global_sum[0] / pixels_count, (unsigned long long)global_sum[1] / pixels_count, (unsigned long long)global_sum[2] / pixels_count);
+	printf("Info: Your %s file was successfully created \n", output_image_name);
+	return SUCCESS;
+}
+#endif
+
 void print_help() {
 	printf("mosaic_%s C M -i input_file -o output_file [options]\n", USER_NAME);
 
@@ -388,7 +689,23 @@ void print_help() {
 		"\t               to write the mosaic image\n");
 	printf("[options]:\n");
 	printf("\t-f ppm_format  PPM image output format either PPM_BINARY (default) or \n"
-		"\t               PPM_PLAIN_TEXT\n ");
+		"\t               PPM_PLAIN_TEXT\n");
+	printf("\t-a averaging   Block averaging either SRGB (default) on the encoded\n"
+		"\t               values or LINEAR for gamma correct averaging in linear light\n");
+	printf("\t-s stats_file  Writes the mean, variance, min and max of every mosaic\n"
+		"\t               block computed in the same pass as the mosaic. This makes\n"
+		"\t               the mosaic kernel about 1.6-1.9x slower\n");
+	printf("\t-sf format     Statistics file format either CSV (default) or BINARY\n");
+	printf("\t-sh bins       Adds a luminance histogram with the given number of\n"
+		"\t               bins (1 to %d) to every block statistics, the kernel\n"
+		"\t               is then about 2.5-3x slower\n", MAX_HISTOGRAM_BINS);
+	printf("\t--create N     Creates the output file of N --shard workers, it must\n"
+		"\t               run once before the workers start\n");
+	printf("\t--shard k/N    Mosaics only the k-th of N block row ranges of a P6 image\n"
+		"\t               and writes it in place inside the created output file\n");
+	printf("\t--shards N     Creates the output, forks N local --shard workers and\n"
+		"\t               merges their averages\n");
+	printf("\t--merge N      Merges the averages written by N --shard workers\n");
 }
 
 int process_command_line(int argc, char *argv[]) {
@@ -463,34 +780,152 @@ int process_command_line(int argc, char *argv[]) {
 	output_image_name = argv[6];
 	printf("Info: Output file -> %s \n", output_image_name);
 
-	//read in the output file format
-	if (argv[7])
+	//read in the optional arguments
+	for (int arg = 7; arg < argc; arg += 2)
 	{
-		if (strcmp(argv[7], "-f") != 0)
+		//read in the output file format
+		if (strcmp(argv[arg], "-f") == 0)
 		{
-			fprintf(stderr, "Error: Expected -f argument followed by format type as optional arguments \n");
-			return FAILURE;
-		}
+			if (arg + 1 >= argc)
+			{
+				fprintf(stderr, "Error: Please specify a file output format after -f \n");
+				return FAILURE;
+			}
 
-		if (argv[8])
-		{
-			if (strcmp(argv[8], "PPM_BINARY") == 0) {
+			if (strcmp(argv[arg + 1], "PPM_BINARY") == 0) {
 				output_format = PPM_BINARY;
 				printf("Info: Output format -> PPM_BINARY \n");
 			}
-			else if (strcmp(argv[8], "PPM_PLAIN_TEXT") == 0) {
+			else if (strcmp(argv[arg + 1], "PPM_PLAIN_TEXT") == 0) {
 				output_format = PPM_PLAIN_TEXT;
 				printf("Info: Output format -> PPM_PLAIN_TEXT \n");
 			}
 			else
 				fprintf(stderr, "Error: Not a recognized output format. Will use the default one -> PPM_BINARY \n");
 		}
+		//read in the block statistics file name
+		else if (strcmp(argv[arg], "-s") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				fprintf(stderr, "Error: Please specify a statistics file name after -s \n");
+				return FAILURE;
+			}
+
+			stats_file_name = argv[arg + 1];
+			printf("Info: Statistics file -> %s \n", stats_file_name);
+		}
+		//read in the block statistics file format
+		else if (strcmp(argv[arg], "-sf") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				fprintf(stderr, "Error: Please specify a statistics format after -sf \n");
+				return FAILURE;
+			}
+
+			if (strcmp(argv[arg + 1], "CSV") == 0) {
+				stats_format = STATS_CSV;
+				printf("Info: Statistics format -> CSV \n");
+			}
+			else if (strcmp(argv[arg + 1], "BINARY") == 0) {
+				stats_format = STATS_BINARY;
+				printf("Info: Statistics format -> BINARY \n");
+			}
+			else
+				fprintf(stderr, "Error: Not a recognized statistics format. Will use the default one -> CSV \n");
+		}
+		//read in the number of luminance histogram bins
+		else if (strcmp(argv[arg], "-sh") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				fprintf(stderr, "Error: Please specify the number of histogram bins after -sh \n");
+				return FAILURE;
+			}
+
+			histogram_bins = (unsigned int)atoi(argv[arg + 1]);
+			if (histogram_bins < 1 || histogram_bins > MAX_HISTOGRAM_BINS)
+			{
+				fprintf(stderr, "Error: Number of histogram bins must be between 1 and %d \n", MAX_HISTOGRAM_BINS);
+				return FAILURE;
+			}
+			printf("Info: Histogram bins -> %d \n", histogram_bins);
+		}
+		//read in the averaging mode
+		else if (strcmp(argv[arg], "-a") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				fprintf(stderr, "Error: Please specify an averaging mode after -a \n");
+				return FAILURE;
+			}
+
+			if (strcmp(argv[arg + 1], "SRGB") == 0) {
+				averaging_mode = AVERAGE_SRGB;
+				printf("Info: Averaging mode -> SRGB \n");
+			}
+			else if (strcmp(argv[arg + 1], "LINEAR") == 0) {
+				averaging_mode = AVERAGE_LINEAR;
+				printf("Info: Averaging mode -> LINEAR \n");
+			}
+			else
+				fprintf(stderr, "Error: Not a recognized averaging mode. Will use the default one -> SRGB \n");
+		}
+		//read in the shard of this worker
+		else if (strcmp(argv[arg], "--shard") == 0)
+		{
+			if (arg + 1 >= argc || sscanf(argv[arg + 1], "%u/%u", &shard_index, &shard_count) != 2
+				|| shard_count < 1 || shard_index >= shard_count)
+			{
+				fprintf(stderr, "Error: Please specify the shard as k/N with k between 0 and N - 1 after --shard \n");
+				return FAILURE;
+			}
+
+			shard_mode = SHARD_WORKER;
+			printf("Info: Shard -> %d/%d \n", shard_index, shard_count);
+		}
+		//read in the number of local shard workers or of shards to merge
+		else if (strcmp(argv[arg], "--shards") == 0 || strcmp(argv[arg], "--create") == 0 || strcmp(argv[arg], "--merge") == 0)
+		{
+			if (arg + 1 >= argc || (shard_count = (unsigned int)atoi(argv[arg + 1])) < 1)
+			{
+				fprintf(stderr, "Error: Please specify a number of shards greater than 0 after %s \n", argv[arg]);
+				return FAILURE;
+			}
+
+			if (strcmp(argv[arg], "--shards") == 0) shard_mode = SHARD_LAUNCH;
+			else if (strcmp(argv[arg], "--create") == 0) shard_mode = SHARD_CREATE;
+			else shard_mode = SHARD_MERGE;
+			printf("Info: Shards -> %d \n", shard_count);
+		}
 		else
 		{
-			fprintf(stderr, "Error: Please specify a file output format after -f \n");
+			fprintf(stderr, "Error: Expected -f, -a, -s, -sf, -sh, --create, --shard, --shards or --merge argument followed by its value as optional arguments \n");
 			return FAILURE;
 		}
 	}
 
+	if (shard_mode != SHARD_NONE)
+	{
+#ifdef _WIN32
+		fprintf(stderr, "Error: Shard mode is only available on POSIX systems \n");
+		return FAILURE;
+#endif
+		if (execution_mode != CPU && execution_mode != OPENMP)
+		{
+			fprintf(stderr, "Error: Shard mode requires the CPU or OPENMP mode \n");
+			return FAILURE;
+		}
+		if (output_format != PPM_BINARY || stats_file_name != NULL)
+		{
+			fprintf(stderr, "Error: Shard mode only writes PPM_BINARY images without block statistics \n");
+			return FAILURE;
+		}
+	}
+
+	if (stats_file_name == NULL && (histogram_bins || stats_format != STATS_CSV))
+		fprintf(stderr, "Error: Statistics options are ignored without -s stats_file \n");
+
 	return SUCCESS;
 }
\ No newline at end of file